@@ -0,0 +1,48 @@
+#ifndef CUCKOO_H
+#define CUCKOO_H
+
+#include "hashmap.h"
+#include "llist.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CUCKOO_SLOTS 4                // Slots per bucket, 4 pairs fill a 64 byte cache line
+#define CUCKOO_STASH 8                // Overflow entries kept outside the buckets
+
+typedef struct cuckoo_bucket {
+  _Alignas(64) pair slots[CUCKOO_SLOTS]; // Empty slots have a NULL key
+} cuckoo_bucket;
+
+typedef struct cuckoo {
+  size_t nbuckets;                    // Number of buckets, always a power of two
+  size_t len;                         // Number of entries, including the stash
+  uint64_t (*hash1)(pair *p);         // Picks the first candidate bucket
+  uint64_t (*hash2)(pair *p);         // Picks the second candidate bucket
+  llist_compare_fn cmp;               // Comparison function for keys
+  cuckoo_bucket *buckets;             // Cache line aligned bucket array
+  size_t stash_len;                   // Number of entries in stash
+  pair stash[CUCKOO_STASH];           // Entries that could not be placed in a bucket
+} cuckoo;
+
+cuckoo *cuckoo_new(size_t cap, uint64_t (*hash1)(pair *p), uint64_t (*hash2)(pair *p), llist_compare_fn cmp);
+
+void cuckoo_free(cuckoo *table);
+
+// Finds the corresponding value if this pair's key exists in the table
+pair *cuckoo_get(cuckoo *table, pair *p);
+
+// Sets the key-value pair in the table, overwriting previous values if they exist.
+// Returns false if the pair could not be placed.
+bool cuckoo_set(cuckoo *table, pair *p);
+
+// Deletes the key-value pair from the table if it exists, given the pair
+void cuckoo_delete(cuckoo *table, pair *p);
+
+// Tests
+void test_cuckoo_new();
+void test_cuckoo_set();
+void test_cuckoo_delete();
+void test_cuckoo_grow();
+void test_cuckoo_collisions();
+#endif
@@ -16,10 +16,25 @@ typedef struct hashmap {
   uint64_t (*hash)(pair *p);        // Hash function operates on key
   llist_compare_fn cmp;               // llist comparison function for hashmap keys
   llist_node **buckets;              // Flexible array member for chaining
+  llist_node *pool;                   // Contiguous node block from hashmap_build, or NULL
+  size_t pool_len;                    // Number of nodes in pool
 } hashmap;
 
+// Cursor over the entries of a hashmap, in bucket order
+typedef struct hashmap_iter {
+  hashmap *map;
+  size_t bucket;                      // Next bucket to scan once next runs out
+  llist_node *next;                   // Node returned by the next call to hashmap_iter_next
+} hashmap_iter;
+
 hashmap *hashmap_new(size_t cap, uint64_t (*hash)(pair *p), llist_compare_fn);
 
+// Builds a hashmap sized for n entries from parallel key and value arrays,
+// splitting the work across up to `threads` threads. Repeated keys keep only the
+// last value, as with repeated hashmap_set calls.
+hashmap *hashmap_build(void **keys, void **values, size_t n, size_t threads,
+                       uint64_t (*hash)(pair *p), llist_compare_fn cmp);
+
 void hashmap_free(hashmap *map);
 
 // Finds the corresponding value if this pair's key exists in the hashmap
@@ -31,9 +46,25 @@ void hashmap_set(hashmap *map, pair *p);
 // Deletes the key-value pair from the hashmap if it exists, given the pair
 void hashmap_delete(hashmap *map, pair *p);
 
+// Starts an iterator at the first entry of the hashmap
+void hashmap_iter_init(hashmap *map, hashmap_iter *it);
+
+// Returns the current entry and advances the iterator, or NULL once every entry has
+// been visited. The returned entry may be deleted before the next call.
+pair *hashmap_iter_next(hashmap_iter *it);
+
+// Calls fn on every entry, splitting the buckets across up to `threads` threads
+void hashmap_foreach_parallel(hashmap *map, size_t threads, void (*fn)(pair *p, void *arg), void *arg);
+
 // Tests
+uint64_t hash_pair_key(pair *p);
+bool hashmap_compare_pairs(const void *a, const void *b);
 void test_hashmap_new();
 void test_hashmap_set();
 void test_hashmap_get();
 void test_hashmap_delete();
+void test_hashmap_build();
+pair *test_pairs(size_t n);
+void test_hashmap_iter();
+void test_hashmap_foreach_parallel();
 #endif
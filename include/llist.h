@@ -27,6 +27,9 @@ void llist_free(llist_node *node);
 // Find a node in the linked list using the compare function
 llist_node *llist_find(llist_node *head, void *data, llist_compare_fn cmp);
 
+// Unlink a node found using the compare function and return it without freeing it
+llist_node *llist_remove(llist_node **head, void *data, llist_compare_fn cmp);
+
 // Delete a node in the linked list found using the compare function
 void llist_delete(llist_node **head, void *data, llist_compare_fn cmp);
 
@@ -35,6 +38,7 @@ void test_llist_prepend();
 void test_llist_free();
 void test_llist_find();
 void test_llist_delete();
+void test_llist_remove();
 void test_llist_prepend_pair();
 void test_llist_find_pair();
 void test_buckets();
@@ -1,5 +1,6 @@
 #include <assert.h>
 #include <hashmap.h>
+#include <cuckoo.h>
 
 #include "llist.h"
 #include <stdio.h>
@@ -18,6 +19,7 @@ int main() {
     test_llist_free();
     test_llist_find();
     test_llist_delete();
+    test_llist_remove();
     test_llist_prepend_pair();
     test_llist_find_pair();
     test_buckets();
@@ -27,6 +29,16 @@ int main() {
     test_hashmap_set();
     test_hashmap_get();
     test_hashmap_delete();
+    test_hashmap_build();
+    test_hashmap_iter();
+    test_hashmap_foreach_parallel();
+
+    printf("Running cuckoo tests...\n");
+    test_cuckoo_new();
+    test_cuckoo_set();
+    test_cuckoo_delete();
+    test_cuckoo_grow();
+    test_cuckoo_collisions();
     printf("All tests passed!\n");
     return 0;
 }
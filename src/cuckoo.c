@@ -0,0 +1,484 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <assert.h>
+#include "cuckoo.h"
+
+#include "hashmap.h"
+
+// Most buckets a single insert will search through when relocating pairs
+#define CUCKOO_BFS_MAX 256
+
+// Most times a failed insert will double the table before giving up
+#define CUCKOO_MAX_GROWS 3
+
+// cuckoo_alloc_buckets returns n zeroed buckets, aligned so each one fills exactly
+// one cache line
+static cuckoo_bucket *cuckoo_alloc_buckets(size_t n) {
+    cuckoo_bucket *buckets = (cuckoo_bucket *)aligned_alloc(_Alignof(cuckoo_bucket), n * sizeof(cuckoo_bucket));
+    if (buckets == NULL) {
+        return NULL;
+    }
+    for (size_t b = 0; b < n; b++) {
+        for (int s = 0; s < CUCKOO_SLOTS; s++) {
+            buckets[b].slots[s].key = NULL;
+            buckets[b].slots[s].value = NULL;
+        }
+    }
+    return buckets;
+}
+
+// cuckoo_new initialises and returns a cuckoo hash table.
+// Every key can live in one of two buckets, picked by `hash1` and `hash2`, and each
+// bucket holds CUCKOO_SLOTS pairs in a single cache line. A lookup therefore reads
+// at most two bucket lines, plus the small stash if anything overflowed into it.
+// Param `cap` is the number of entries to size the table for. It grows when full.
+// Keys must not be NULL, as a NULL key marks an empty slot.
+// Returns NULL if memory for the table could not be allocated.
+cuckoo *cuckoo_new(size_t cap, uint64_t (*hash1)(pair *p), uint64_t (*hash2)(pair *p), llist_compare_fn cmp) {
+    size_t nbuckets = 4;
+    while (nbuckets * CUCKOO_SLOTS < cap) {
+        nbuckets *= 2;
+    }
+
+    cuckoo *table = (cuckoo *)malloc(sizeof(cuckoo));
+    if (table == NULL) {
+        return NULL;
+    }
+    table->nbuckets = nbuckets;
+    table->len = 0;
+    table->hash1 = hash1;
+    table->hash2 = hash2;
+    table->cmp = cmp;
+    table->buckets = cuckoo_alloc_buckets(nbuckets);
+    table->stash_len = 0;
+    if (table->buckets == NULL) {
+        free(table);
+        return NULL;
+    }
+    return table;
+}
+
+// cuckoo_free frees the table completely
+void cuckoo_free(cuckoo *table) {
+    free(table->buckets);
+    free(table);
+}
+
+static size_t cuckoo_bucket1(cuckoo *table, pair *p) {
+    return table->hash1(p) & (table->nbuckets - 1);
+}
+
+static size_t cuckoo_bucket2(cuckoo *table, pair *p) {
+    return table->hash2(p) & (table->nbuckets - 1);
+}
+
+// cuckoo_alt_bucket returns the other candidate bucket for a pair stored in bucket b
+static size_t cuckoo_alt_bucket(cuckoo *table, pair *p, size_t b) {
+    size_t b1 = cuckoo_bucket1(table, p);
+    return (b1 == b) ? cuckoo_bucket2(table, p) : b1;
+}
+
+// cuckoo_free_slot returns the index of an empty slot in the bucket, or -1 if full
+static int cuckoo_free_slot(cuckoo_bucket *bucket) {
+    for (int s = 0; s < CUCKOO_SLOTS; s++) {
+        if (bucket->slots[s].key == NULL) {
+            return s;
+        }
+    }
+    return -1;
+}
+
+// cuckoo_find returns the stored pair with the same key as p, or NULL
+static pair *cuckoo_find(cuckoo *table, pair *p) {
+    cuckoo_bucket *bucket = &table->buckets[cuckoo_bucket1(table, p)];
+    for (int s = 0; s < CUCKOO_SLOTS; s++) {
+        if (bucket->slots[s].key != NULL && table->cmp(&bucket->slots[s], p)) {
+            return &bucket->slots[s];
+        }
+    }
+    bucket = &table->buckets[cuckoo_bucket2(table, p)];
+    for (int s = 0; s < CUCKOO_SLOTS; s++) {
+        if (bucket->slots[s].key != NULL && table->cmp(&bucket->slots[s], p)) {
+            return &bucket->slots[s];
+        }
+    }
+    for (size_t i = 0; i < table->stash_len; i++) {
+        if (table->cmp(&table->stash[i], p)) {
+            return &table->stash[i];
+        }
+    }
+    return NULL;
+}
+
+// One bucket reached while searching for a free slot
+typedef struct cuckoo_bfs_entry {
+    size_t bucket;
+    int parent;   // Index of the entry this bucket was reached from, -1 for a root
+    int slot;     // Slot in the parent bucket whose pair would move into this bucket
+} cuckoo_bfs_entry;
+
+static bool cuckoo_bfs_seen(cuckoo_bfs_entry *queue, int len, size_t bucket) {
+    for (int i = 0; i < len; i++) {
+        if (queue[i].bucket == bucket) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// cuckoo_relocate makes room for p in one of its full candidate buckets b1 and b2.
+// It searches breadth first for the shortest chain of pairs that can each move to
+// their other bucket, ending at a bucket with a free slot, then shifts the chain
+// along and puts p in the slot freed at the start. Every bucket appears at most
+// once in the search, so the moves along a chain never overlap.
+// Returns false if no chain was found within CUCKOO_BFS_MAX buckets.
+static bool cuckoo_relocate(cuckoo *table, size_t b1, size_t b2, pair *p) {
+    cuckoo_bfs_entry queue[CUCKOO_BFS_MAX];
+    int head = 0;
+    int tail = 0;
+
+    queue[tail++] = (cuckoo_bfs_entry){ .bucket = b1, .parent = -1, .slot = -1 };
+    if (b2 != b1) {
+        queue[tail++] = (cuckoo_bfs_entry){ .bucket = b2, .parent = -1, .slot = -1 };
+    }
+
+    while (head < tail) {
+        int cur = head++;
+        cuckoo_bucket *bucket = &table->buckets[queue[cur].bucket];
+
+        for (int s = 0; s < CUCKOO_SLOTS; s++) {
+            size_t alt = cuckoo_alt_bucket(table, &bucket->slots[s], queue[cur].bucket);
+            if (alt == queue[cur].bucket || cuckoo_bfs_seen(queue, tail, alt)) {
+                continue;
+            }
+
+            int free_slot = cuckoo_free_slot(&table->buckets[alt]);
+            if (free_slot >= 0) {
+                // Shift every pair on the chain one step towards the free slot
+                table->buckets[alt].slots[free_slot] = bucket->slots[s];
+                int hole = s;
+                while (queue[cur].parent >= 0) {
+                    cuckoo_bfs_entry *e = &queue[cur];
+                    table->buckets[e->bucket].slots[hole] = table->buckets[queue[e->parent].bucket].slots[e->slot];
+                    hole = e->slot;
+                    cur = e->parent;
+                }
+                table->buckets[queue[cur].bucket].slots[hole] = *p;
+                return true;
+            }
+
+            if (tail < CUCKOO_BFS_MAX) {
+                queue[tail++] = (cuckoo_bfs_entry){ .bucket = alt, .parent = cur, .slot = s };
+            }
+        }
+    }
+    return false;
+}
+
+// cuckoo_place stores p, whose key must not already be in the table, without
+// growing the table. It tries a free slot in either bucket, then relocation, and
+// then the stash if `use_stash` is set.
+static bool cuckoo_place(cuckoo *table, pair *p, bool use_stash) {
+    size_t b1 = cuckoo_bucket1(table, p);
+    size_t b2 = cuckoo_bucket2(table, p);
+
+    int s = cuckoo_free_slot(&table->buckets[b1]);
+    if (s >= 0) {
+        table->buckets[b1].slots[s] = *p;
+    } else if ((s = cuckoo_free_slot(&table->buckets[b2])) >= 0) {
+        table->buckets[b2].slots[s] = *p;
+    } else if (!cuckoo_relocate(table, b1, b2, p)) {
+        if (!use_stash || table->stash_len == CUCKOO_STASH) {
+            return false;
+        }
+        table->stash[table->stash_len++] = *p;
+    }
+    table->len++;
+    return true;
+}
+
+// cuckoo_resize rehashes every entry into a table of nbuckets buckets.
+// On failure the table is left unchanged and false is returned.
+static bool cuckoo_resize(cuckoo *table, size_t nbuckets) {
+    cuckoo resized = *table;
+    resized.nbuckets = nbuckets;
+    resized.len = 0;
+    resized.stash_len = 0;
+    resized.buckets = cuckoo_alloc_buckets(nbuckets);
+    if (resized.buckets == NULL) {
+        return false;
+    }
+
+    for (size_t b = 0; b < table->nbuckets; b++) {
+        for (int s = 0; s < CUCKOO_SLOTS; s++) {
+            pair *p = &table->buckets[b].slots[s];
+            if (p->key != NULL && !cuckoo_place(&resized, p, true)) {
+                free(resized.buckets);
+                return false;
+            }
+        }
+    }
+    for (size_t i = 0; i < table->stash_len; i++) {
+        if (!cuckoo_place(&resized, &table->stash[i], true)) {
+            free(resized.buckets);
+            return false;
+        }
+    }
+
+    free(table->buckets);
+    *table = resized;
+    return true;
+}
+
+// cuckoo_unstash moves stash entries back into their buckets where there is room
+static void cuckoo_unstash(cuckoo *table) {
+    size_t i = 0;
+    while (i < table->stash_len) {
+        pair *p = &table->stash[i];
+        size_t b1 = cuckoo_bucket1(table, p);
+        size_t b2 = cuckoo_bucket2(table, p);
+        int s;
+
+        if ((s = cuckoo_free_slot(&table->buckets[b1])) >= 0) {
+            table->buckets[b1].slots[s] = *p;
+        } else if ((s = cuckoo_free_slot(&table->buckets[b2])) >= 0) {
+            table->buckets[b2].slots[s] = *p;
+        } else {
+            i++;
+            continue;
+        }
+        table->stash[i] = table->stash[--table->stash_len];
+    }
+}
+
+// cuckoo_get returns the value based on the provided key. If the item is not
+// found then NULL is returned.
+pair *cuckoo_get(cuckoo *table, pair *p) {
+    return cuckoo_find(table, p);
+}
+
+// cuckoo_set inserts or replaces a value in the table.
+// Inserting may move other pairs between their two buckets, so pointers returned
+// by cuckoo_get are only valid until the next cuckoo_set or cuckoo_delete.
+// If the pair does not fit in a table that is at least half full, the table
+// doubles in size. Otherwise the pair goes into the stash, and false is returned
+// if the stash is full too.
+// This operation may allocate memory.
+bool cuckoo_set(cuckoo *table, pair *p) {
+    pair *found = cuckoo_find(table, p);
+    if (found != NULL) {
+        *found = *p;
+        return true;
+    }
+    if (cuckoo_place(table, p, false)) {
+        return true;
+    }
+
+    // Below half full, a failure means too many keys share both of their buckets,
+    // which growing would not fix
+    if (table->len >= table->nbuckets * CUCKOO_SLOTS / 2) {
+        size_t nbuckets = table->nbuckets;
+        for (int i = 0; i < CUCKOO_MAX_GROWS; i++) {
+            nbuckets *= 2;
+            if (cuckoo_resize(table, nbuckets)) {
+                break;
+            }
+        }
+    }
+    return cuckoo_place(table, p, true);
+}
+
+// cuckoo_delete removes an item from the table.
+void cuckoo_delete(cuckoo *table, pair *p) {
+    pair *found = cuckoo_find(table, p);
+    if (found == NULL) {
+        return;
+    }
+
+    if (found >= table->stash && found < table->stash + table->stash_len) {
+        *found = table->stash[--table->stash_len];
+    } else {
+        found->key = NULL;
+        found->value = NULL;
+        cuckoo_unstash(table);
+    }
+    table->len--;
+}
+
+// Tests
+uint64_t cuckoo_hash_djb2(pair *p) {
+    const unsigned char *str = (const unsigned char *)p->key;
+    uint64_t hash = 5381;
+
+    while (*str) {
+        hash = hash * 33 + *str;
+        str++;
+    }
+
+    // mix the high bits down so the low bits used for indexing vary more
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// Sends every key to the same bucket under both hash functions
+uint64_t cuckoo_hash_const(pair *p) {
+    (void)p;
+    return 7;
+}
+
+void test_cuckoo_new() {
+    assert(sizeof(cuckoo_bucket) == 64);
+
+    cuckoo *table = cuckoo_new(100, hash_pair_key, cuckoo_hash_djb2, hashmap_compare_pairs);
+    assert(table->nbuckets == 32);
+    assert(table->len == 0);
+    assert(table->stash_len == 0);
+    assert((uintptr_t)table->buckets % 64 == 0);
+    for (size_t b = 0; b < table->nbuckets; b++) {
+        for (int s = 0; s < CUCKOO_SLOTS; s++) {
+            assert(table->buckets[b].slots[s].key == NULL);
+        }
+    }
+    cuckoo_free(table);
+
+    // a zero capacity still gets the minimum number of buckets
+    table = cuckoo_new(0, hash_pair_key, cuckoo_hash_djb2, hashmap_compare_pairs);
+    assert(table->nbuckets == 4);
+    cuckoo_free(table);
+}
+
+void test_cuckoo_set() {
+    cuckoo *table = cuckoo_new(64, hash_pair_key, cuckoo_hash_djb2, hashmap_compare_pairs);
+
+    pair pair1 = { .key = "helloworld", .value = &(int){123} };
+    assert(cuckoo_set(table, &pair1));
+
+    pair pair2 = { .key = "pair2", .value = &(int){321} };
+    assert(cuckoo_set(table, &pair2));
+
+    // overwrite pair1's value
+    pair pair3 = { .key = "helloworld", .value = &(int){456} };
+    assert(cuckoo_set(table, &pair3));
+    assert(table->len == 2);
+
+    pair *found_pair = cuckoo_get(table, &pair1);
+    assert(found_pair->key == pair1.key);
+    assert(*(int *)found_pair->value == 456);
+
+    found_pair = cuckoo_get(table, &pair2);
+    assert(found_pair->key == pair2.key);
+    assert(*(int *)found_pair->value == 321);
+
+    pair pair4 = { .key = "pair4", .value = &(int){0} };
+    assert(cuckoo_get(table, &pair4) == NULL);
+
+    cuckoo_free(table);
+}
+
+void test_cuckoo_delete() {
+    cuckoo *table = cuckoo_new(64, hash_pair_key, cuckoo_hash_djb2, hashmap_compare_pairs);
+
+    pair pair1 = { .key = "abc", .value = &(int){123} };
+    pair pair2 = { .key = "bac", .value = &(int){321} };
+    pair pair3 = { .key = "xyz", .value = &(int){456} };
+    cuckoo_set(table, &pair1);
+    cuckoo_set(table, &pair2);
+    cuckoo_set(table, &pair3);
+
+    cuckoo_delete(table, &pair1);
+    assert(cuckoo_get(table, &pair1) == NULL);
+    assert(*(int *)cuckoo_get(table, &pair2)->value == 321);
+    assert(*(int *)cuckoo_get(table, &pair3)->value == 456);
+    assert(table->len == 2);
+
+    // deleting a missing key does nothing
+    cuckoo_delete(table, &pair1);
+    assert(table->len == 2);
+
+    cuckoo_delete(table, &pair2);
+    cuckoo_delete(table, &pair3);
+    assert(cuckoo_get(table, &pair2) == NULL);
+    assert(cuckoo_get(table, &pair3) == NULL);
+    assert(table->len == 0);
+
+    cuckoo_free(table);
+}
+
+void test_cuckoo_grow() {
+    enum { N = 5000 };
+    pair *pairs = test_pairs(N);
+    cuckoo *table = cuckoo_new(0, hash_pair_key, cuckoo_hash_djb2, hashmap_compare_pairs);
+    assert(table != NULL);
+
+    for (int i = 0; i < N; i++) {
+        assert(cuckoo_set(table, &pairs[i]));
+    }
+    assert(table->len == N);
+    assert(table->nbuckets * CUCKOO_SLOTS >= N);
+    assert(table->stash_len == 0);
+
+    for (int i = 0; i < N; i++) {
+        pair query = { .key = pairs[i].key };
+        pair *found_pair = cuckoo_get(table, &query);
+        assert(found_pair != NULL);
+        assert(*(int *)found_pair->value == i);
+    }
+
+    // delete every other key
+    for (int i = 0; i < N; i += 2) {
+        pair query = { .key = pairs[i].key };
+        cuckoo_delete(table, &query);
+    }
+    assert(table->len == N / 2);
+    for (int i = 0; i < N; i++) {
+        pair query = { .key = pairs[i].key };
+        assert((cuckoo_get(table, &query) == NULL) == (i % 2 == 0));
+    }
+
+    cuckoo_free(table);
+    free(pairs);
+}
+
+void test_cuckoo_collisions() {
+    enum { N = CUCKOO_SLOTS + CUCKOO_STASH };
+    pair *pairs = test_pairs(N + 1);
+    cuckoo *table = cuckoo_new(64, cuckoo_hash_const, cuckoo_hash_const, hashmap_compare_pairs);
+
+    // every key lands in one bucket, the rest overflow into the stash
+    for (int i = 0; i < N; i++) {
+        assert(cuckoo_set(table, &pairs[i]));
+    }
+    assert(table->stash_len == CUCKOO_STASH);
+
+    // once the bucket and stash are full the insert fails without growing
+    assert(!cuckoo_set(table, &pairs[N]));
+    assert(table->nbuckets == 16);
+    assert(table->len == N);
+
+    for (int i = 0; i < N; i++) {
+        pair query = { .key = pairs[i].key };
+        assert(*(int *)cuckoo_get(table, &query)->value == i);
+    }
+
+    // deleting from the bucket pulls a stash entry back into it
+    pair query = { .key = pairs[0].key };
+    cuckoo_delete(table, &query);
+    assert(table->stash_len == CUCKOO_STASH - 1);
+    assert(cuckoo_get(table, &query) == NULL);
+    for (int i = 1; i < N; i++) {
+        pair query = { .key = pairs[i].key };
+        assert(*(int *)cuckoo_get(table, &query)->value == i);
+    }
+
+    // deleting from the stash
+    query.key = pairs[N - 1].key;
+    cuckoo_delete(table, &query);
+    assert(cuckoo_get(table, &query) == NULL);
+    assert(table->len == N - 2);
+
+    cuckoo_free(table);
+    free(pairs);
+}
@@ -4,6 +4,8 @@
 #include "hashmap.h"
 #include <assert.h>
 #include <stdio.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 #include "llist.h"
 #include "string.h"
@@ -13,15 +15,25 @@
 // Param `cap` is the default lower capacity of the hashmap. Setting this to
 // zero will default to 16.
 // Param `hash` is a function that generates a hash value for a given key.
+// Returns NULL if memory for the hashmap could not be allocated.
 hashmap *hashmap_new(size_t cap, uint64_t (*hash)(pair *p), llist_compare_fn cmp) {
     size_t ncap = 16;
     cap = (cap < ncap) ? ncap : cap;
 
     hashmap *map = (hashmap *)malloc(sizeof(hashmap));
+    if (map == NULL) {
+        return NULL;
+    }
     map->cap = (cap < ncap) ? ncap : cap;
     map->hash = hash;
     map->cmp = cmp;
     map->buckets = (llist_node **)malloc(cap * sizeof(llist_node *));
+    if (map->buckets == NULL) {
+        free(map);
+        return NULL;
+    }
+    map->pool = NULL;
+    map->pool_len = 0;
     // Initialize buckets with simple integer data wrapped in llist_node
     for (size_t i = 0; i < map->cap; i++) {
         map->buckets[i] = NULL;
@@ -29,12 +41,224 @@ hashmap *hashmap_new(size_t cap, uint64_t (*hash)(pair *p), llist_compare_fn cmp
     return map;
 }
 
+// Most threads hashmap_build and hashmap_foreach_parallel will use, whatever the
+// caller asks for
+#define HASHMAP_MAX_THREADS 64
+
+// hashmap_run_parallel runs fn once per element of args, each on its own thread.
+// Element 0 runs on the calling thread. If a thread cannot be created its work is
+// run on the calling thread instead, so every element is always processed.
+static void hashmap_run_parallel(size_t threads, void *(*fn)(void *), void *args, size_t arg_size) {
+    pthread_t *tids = (pthread_t *)malloc(threads * sizeof(pthread_t));
+    bool *started = (bool *)malloc(threads * sizeof(bool));
+    char *base = (char *)args;
+
+    if (tids == NULL || started == NULL) {
+        for (size_t i = 0; i < threads; i++) {
+            fn(base + i * arg_size);
+        }
+        free(started);
+        free(tids);
+        return;
+    }
+
+    for (size_t i = 1; i < threads; i++) {
+        started[i] = pthread_create(&tids[i], NULL, fn, base + i * arg_size) == 0;
+    }
+    fn(base);
+    for (size_t i = 1; i < threads; i++) {
+        if (started[i]) {
+            pthread_join(tids[i], NULL);
+        } else {
+            fn(base + i * arg_size);
+        }
+    }
+    free(started);
+    free(tids);
+}
+
+// Shared state for hashmap_build. Entries are split into contiguous slices by
+// worker, and buckets are split into contiguous ranges (partitions) of `span`
+// buckets, also one per worker.
+typedef struct build_ctx {
+    hashmap *map;
+    void **keys;
+    void **values;
+    size_t n;
+    size_t threads;
+    size_t span;          // Number of buckets in each partition
+    pair *pairs;          // Pair storage inside the node pool
+    uint64_t *idx;        // Bucket index of every entry
+    size_t *offsets;      // threads x threads, indexed [worker * threads + partition]
+    size_t *part_start;   // threads + 1 partition boundaries within order
+    size_t *order;        // Entry indices grouped by partition, stable within each
+} build_ctx;
+
+typedef struct build_worker {
+    build_ctx *ctx;
+    size_t id;
+} build_worker;
+
+// Phase 1: fill in this worker's nodes, hash them and count entries per partition
+static void *build_hash(void *arg) {
+    build_worker *w = (build_worker *)arg;
+    build_ctx *ctx = w->ctx;
+    size_t lo = ctx->n * w->id / ctx->threads;
+    size_t hi = ctx->n * (w->id + 1) / ctx->threads;
+
+    // Count on the stack so workers don't share cache lines of offsets per entry
+    size_t counts[HASHMAP_MAX_THREADS] = { 0 };
+    for (size_t i = lo; i < hi; i++) {
+        ctx->pairs[i].key = ctx->keys[i];
+        ctx->pairs[i].value = ctx->values[i];
+        ctx->map->pool[i].data = &ctx->pairs[i];
+        ctx->map->pool[i].next = NULL;
+        ctx->idx[i] = ctx->map->hash(&ctx->pairs[i]) % ctx->map->cap;
+        counts[ctx->idx[i] / ctx->span]++;
+    }
+    memcpy(&ctx->offsets[w->id * ctx->threads], counts, ctx->threads * sizeof(size_t));
+    return NULL;
+}
+
+// Phase 2: scatter this worker's entry indices into their partitions
+static void *build_scatter(void *arg) {
+    build_worker *w = (build_worker *)arg;
+    build_ctx *ctx = w->ctx;
+    size_t lo = ctx->n * w->id / ctx->threads;
+    size_t hi = ctx->n * (w->id + 1) / ctx->threads;
+    size_t offsets[HASHMAP_MAX_THREADS];
+    memcpy(offsets, &ctx->offsets[w->id * ctx->threads], ctx->threads * sizeof(size_t));
+
+    for (size_t i = lo; i < hi; i++) {
+        ctx->order[offsets[ctx->idx[i] / ctx->span]++] = i;
+    }
+    return NULL;
+}
+
+// Phase 3: link every entry of this worker's partition into its bucket. Entries are
+// visited in input order, and a later duplicate key overwrites the pair already
+// linked for it, just as repeated hashmap_set calls would.
+static void *build_link(void *arg) {
+    build_worker *w = (build_worker *)arg;
+    build_ctx *ctx = w->ctx;
+    llist_node **buckets = ctx->map->buckets;
+
+    for (size_t j = ctx->part_start[w->id]; j < ctx->part_start[w->id + 1]; j++) {
+        size_t i = ctx->order[j];
+        llist_node *found = llist_find(buckets[ctx->idx[i]], &ctx->pairs[i], ctx->map->cmp);
+        if (found != NULL) {
+            *(pair *)found->data = ctx->pairs[i];
+            continue;
+        }
+        llist_node *node = &ctx->map->pool[i];
+        node->next = buckets[ctx->idx[i]];
+        buckets[ctx->idx[i]] = node;
+    }
+    return NULL;
+}
+
+// hashmap_build initialises a hash map holding n key-value pairs, where the i-th
+// pair is (keys[i], values[i]). The result is the same as calling hashmap_set for
+// each pair in order, but the table is sized once for n entries and every node is
+// allocated from a single contiguous block. A repeated key keeps only its last
+// value; the pool slots of the dropped duplicates are left unused.
+// Param `threads` is the number of threads to use, at most HASHMAP_MAX_THREADS.
+// Zero or one builds on the calling thread.
+// Returns NULL if memory for the build could not be allocated.
+hashmap *hashmap_build(void **keys, void **values, size_t n, size_t threads,
+                       uint64_t (*hash)(pair *p), llist_compare_fn cmp) {
+    hashmap *map = hashmap_new(n, hash, cmp);
+    if (map == NULL || n == 0) {
+        return map;
+    }
+    threads = (threads == 0) ? 1 : threads;
+    threads = (threads > HASHMAP_MAX_THREADS) ? HASHMAP_MAX_THREADS : threads;
+    threads = (threads > n) ? n : threads;
+
+    // Nodes first, followed by the pairs they point to
+    map->pool = (llist_node *)malloc(n * (sizeof(llist_node) + sizeof(pair)));
+    map->pool_len = n;
+
+    build_ctx ctx = {
+        .map = map,
+        .keys = keys,
+        .values = values,
+        .n = n,
+        .threads = threads,
+        .span = (map->cap + threads - 1) / threads,
+        .pairs = (pair *)(map->pool + n),
+        .idx = (uint64_t *)malloc(n * sizeof(uint64_t)),
+        .offsets = (size_t *)calloc(threads * threads, sizeof(size_t)),
+        .part_start = (size_t *)malloc((threads + 1) * sizeof(size_t)),
+        .order = (size_t *)malloc(n * sizeof(size_t)),
+    };
+    build_worker *workers = (build_worker *)malloc(threads * sizeof(build_worker));
+    if (map->pool == NULL || ctx.idx == NULL || ctx.offsets == NULL ||
+        ctx.part_start == NULL || ctx.order == NULL || workers == NULL) {
+        free(ctx.idx);
+        free(ctx.offsets);
+        free(ctx.part_start);
+        free(ctx.order);
+        free(workers);
+        hashmap_free(map);
+        return NULL;
+    }
+    for (size_t i = 0; i < threads; i++) {
+        workers[i].ctx = &ctx;
+        workers[i].id = i;
+    }
+
+    hashmap_run_parallel(threads, build_hash, workers, sizeof(build_worker));
+
+    // Turn the per-worker counts into write offsets, partition-major so that each
+    // partition's entries stay in input order
+    size_t total = 0;
+    for (size_t p = 0; p < threads; p++) {
+        ctx.part_start[p] = total;
+        for (size_t w = 0; w < threads; w++) {
+            size_t count = ctx.offsets[w * threads + p];
+            ctx.offsets[w * threads + p] = total;
+            total += count;
+        }
+    }
+    ctx.part_start[threads] = total;
+
+    hashmap_run_parallel(threads, build_scatter, workers, sizeof(build_worker));
+    hashmap_run_parallel(threads, build_link, workers, sizeof(build_worker));
+
+    free(ctx.idx);
+    free(ctx.offsets);
+    free(ctx.part_start);
+    free(ctx.order);
+    free(workers);
+    return map;
+}
+
+// hashmap_owns_node reports whether node was allocated from the map's node pool
+static bool hashmap_owns_node(hashmap *map, llist_node *node) {
+    return map->pool != NULL && node >= map->pool && node < map->pool + map->pool_len;
+}
+
 // hashmap_free frees the hash map completely
 // Every llist in the hashmap is freed
 void hashmap_free(hashmap *map) {
     for (size_t i = 0; i < map->cap; i++) {
-        llist_free(map->buckets[i]);
+        if (map->pool == NULL) {
+            llist_free(map->buckets[i]);
+            continue;
+        }
+        // Pooled nodes are released together with the pool below
+        llist_node *cur = map->buckets[i];
+        while (cur != NULL) {
+            llist_node *nxt = cur->next;
+            if (!hashmap_owns_node(map, cur)) {
+                free(cur->data);
+                free(cur);
+            }
+            cur = nxt;
+        }
     }
+    free(map->pool);
     free(map->buckets);  // Free the dynamically allocated bucket array
     free(map);
 }
@@ -54,10 +278,19 @@ pair *hashmap_get(hashmap *map, pair *p) {
 
 
 // hashmap_set inserts or replaces a value in the hash map.
+// An existing entry with the same key is overwritten in place, so every key has
+// exactly one node. This means every set walks the bucket's chain to look for the
+// key before inserting, rather than just prepending a new node.
 // This operation may allocate memory.
 void hashmap_set(hashmap *map, pair *p) {
     uint64_t llist_idx = map->hash(p) % map->cap;
 
+    llist_node *found_node = llist_find(map->buckets[llist_idx], p, map->cmp);
+    if (found_node != NULL) {
+        *(pair *)found_node->data = *p;
+        return;
+    }
+
     // Prepend the new node
     map->buckets[llist_idx] = llist_prepend(map->buckets[llist_idx], p, sizeof(pair));
 }
@@ -66,7 +299,101 @@ void hashmap_set(hashmap *map, pair *p) {
 void hashmap_delete(hashmap *map, pair *p) {
     uint64_t llist_idx = map->hash(p) % map->cap;
 
-    llist_delete(&map->buckets[llist_idx], p, map->cmp);
+    llist_node *node = llist_remove(&map->buckets[llist_idx], p, map->cmp);
+    if (node != NULL && !hashmap_owns_node(map, node)) {
+        free(node->data);
+        free(node);
+    }
+}
+
+// hashmap_iter_init points the iterator at the first entry of the hash map.
+// The iterator stays valid if the entry it last returned is deleted, but any other
+// hashmap_set or hashmap_delete during iteration invalidates it.
+void hashmap_iter_init(hashmap *map, hashmap_iter *it) {
+    it->map = map;
+    it->bucket = 0;
+    it->next = NULL;
+}
+
+// hashmap_iter_next returns the next entry, or NULL when there are none left.
+// The iterator moves past the returned entry before handing it out, which is what
+// makes deleting it safe.
+pair *hashmap_iter_next(hashmap_iter *it) {
+    while (it->next == NULL) {
+        if (it->bucket >= it->map->cap) {
+            return NULL;
+        }
+        it->next = it->map->buckets[it->bucket++];
+    }
+    llist_node *cur = it->next;
+    it->next = cur->next;
+    return (pair *)cur->data;
+}
+
+// Number of buckets a foreach worker claims at a time
+#define FOREACH_CHUNK 1024
+
+// How many buckets ahead a foreach worker prefetches chain heads
+#define FOREACH_PREFETCH 8
+
+// Shared state for hashmap_foreach_parallel
+typedef struct foreach_ctx {
+    hashmap *map;
+    void (*fn)(pair *p, void *arg);
+    void *arg;
+    atomic_size_t next_bucket;  // First bucket of the next unclaimed chunk
+} foreach_ctx;
+
+// Claims chunks of buckets until none are left and runs the callback on their entries
+static void *foreach_worker(void *arg) {
+    foreach_ctx *ctx = *(foreach_ctx **)arg;
+    llist_node **buckets = ctx->map->buckets;
+    size_t cap = ctx->map->cap;
+
+    for (;;) {
+        size_t lo = atomic_fetch_add(&ctx->next_bucket, FOREACH_CHUNK);
+        if (lo >= cap) {
+            return NULL;
+        }
+        size_t hi = (cap - lo < FOREACH_CHUNK) ? cap : lo + FOREACH_CHUNK;
+
+        for (size_t i = lo; i < hi; i++) {
+            // Two stage pipeline: fetch the head node a few buckets ahead, and the
+            // pair of the next bucket's head, whose node was fetched earlier
+            if (i + FOREACH_PREFETCH < hi && buckets[i + FOREACH_PREFETCH] != NULL) {
+                __builtin_prefetch(buckets[i + FOREACH_PREFETCH]);
+            }
+            if (i + 1 < hi && buckets[i + 1] != NULL) {
+                __builtin_prefetch(buckets[i + 1]->data);
+            }
+            for (llist_node *cur = buckets[i]; cur != NULL; cur = cur->next) {
+                ctx->fn((pair *)cur->data, ctx->arg);
+            }
+        }
+    }
+}
+
+// hashmap_foreach_parallel calls fn(p, arg) once for every entry in the hash map.
+// Buckets are handed out to the threads in chunks, so calls happen concurrently
+// and in no particular order. fn may modify the value an entry points to but must
+// not set or delete entries.
+// Param `threads` is the number of threads to use, at most HASHMAP_MAX_THREADS.
+// Zero or one runs on the calling thread.
+void hashmap_foreach_parallel(hashmap *map, size_t threads, void (*fn)(pair *p, void *arg), void *arg) {
+    size_t chunks = (map->cap + FOREACH_CHUNK - 1) / FOREACH_CHUNK;
+    threads = (threads == 0) ? 1 : threads;
+    threads = (threads > HASHMAP_MAX_THREADS) ? HASHMAP_MAX_THREADS : threads;
+    threads = (threads > chunks) ? chunks : threads;
+
+    foreach_ctx ctx = { .map = map, .fn = fn, .arg = arg };
+    atomic_init(&ctx.next_bucket, 0);
+
+    foreach_ctx **workers = (foreach_ctx **)malloc(threads * sizeof(foreach_ctx *));
+    for (size_t i = 0; i < threads; i++) {
+        workers[i] = &ctx;
+    }
+    hashmap_run_parallel(threads, foreach_worker, workers, sizeof(foreach_ctx *));
+    free(workers);
 }
 
 // Tests
@@ -215,3 +542,186 @@ void test_hashmap_delete() {
 
     hashmap_free(map);
 }
+
+// Hashes the key string itself, unlike hash_string which sums the pair's bytes
+uint64_t hash_pair_key(pair *p) {
+    const unsigned char *str = (const unsigned char *)p->key;
+    uint64_t hash = 14695981039346656037ULL; // FNV-1a
+
+    while (*str) {
+        hash ^= *str;
+        hash *= 1099511628211ULL;
+        str++;
+    }
+
+    return hash;
+}
+
+void test_hashmap_build() {
+    void *keys[] = { "abc", "bac", "xyz", "helloworld", "abc" };
+    void *values[] = { &(int){123}, &(int){321}, &(int){456}, &(int){789}, &(int){0} };
+    size_t n = sizeof(keys) / sizeof(keys[0]);
+
+    size_t thread_counts[] = { 0, 1, 4, 1000 };
+    for (size_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); t++) {
+        hashmap *map = hashmap_build(keys, values, n, thread_counts[t], hash_pair_key, hashmap_compare_pairs);
+        assert(map != NULL);
+        assert(map->cap == 16);
+
+        pair pair1 = { .key = "bac" };
+        pair *found_pair = hashmap_get(map, &pair1);
+        assert(strcmp((char *)found_pair->key, "bac") == 0);
+        assert(*(int *)found_pair->value == 321);
+
+        pair pair2 = { .key = "xyz" };
+        assert(*(int *)hashmap_get(map, &pair2)->value == 456);
+
+        pair pair3 = { .key = "helloworld" };
+        assert(*(int *)hashmap_get(map, &pair3)->value == 789);
+
+        // the repeated "abc" keeps only its last value, in a single node
+        pair pair4 = { .key = "abc" };
+        assert(*(int *)hashmap_get(map, &pair4)->value == 0);
+        size_t nodes = 0;
+        for (size_t i = 0; i < map->cap; i++) {
+            for (llist_node *cur = map->buckets[i]; cur != NULL; cur = cur->next) {
+                nodes++;
+            }
+        }
+        assert(nodes == n - 1);
+
+        pair pair5 = { .key = "missing" };
+        assert(hashmap_get(map, &pair5) == NULL);
+
+        // pooled and malloc'ed nodes can be mixed freely
+        pair extra = { .key = "extra", .value = &(int){-1} };
+        hashmap_set(map, &extra);
+        assert(*(int *)hashmap_get(map, &extra)->value == -1);
+
+        hashmap_delete(map, &pair2);
+        assert(hashmap_get(map, &pair2) == NULL);
+        hashmap_delete(map, &extra);
+        assert(hashmap_get(map, &extra) == NULL);
+
+        hashmap_free(map);
+    }
+
+    // an empty build is an ordinary empty map
+    hashmap *map = hashmap_build(NULL, NULL, 0, 4, hash_pair_key, hashmap_compare_pairs);
+    assert(map->cap == 16);
+    assert(map->pool == NULL);
+    hashmap_free(map);
+}
+
+// test_pairs returns n pairs with keys "key0", "key1", ... and values pointing to
+// 0, 1, ..., all in one block that is released with a single free
+pair *test_pairs(size_t n) {
+    enum { KEY_LEN = 24 };
+    pair *pairs = (pair *)malloc(n * (sizeof(pair) + sizeof(int) + KEY_LEN));
+    int *nums = (int *)(pairs + n);
+    char *keys = (char *)(nums + n);
+
+    for (size_t i = 0; i < n; i++) {
+        nums[i] = (int)i;
+        snprintf(&keys[i * KEY_LEN], KEY_LEN, "key%zu", i);
+        pairs[i].key = &keys[i * KEY_LEN];
+        pairs[i].value = &nums[i];
+    }
+    return pairs;
+}
+
+void test_hashmap_iter() {
+    hashmap *map = hashmap_new(64, hash_pair_key, hashmap_compare_pairs);
+
+    // an empty map has nothing to visit
+    hashmap_iter it;
+    hashmap_iter_init(map, &it);
+    assert(hashmap_iter_next(&it) == NULL);
+
+    pair pair1 = { .key = "abc", .value = &(int){1} };
+    hashmap_set(map, &pair1);
+
+    pair pair2 = { .key = "bac", .value = &(int){2} };
+    hashmap_set(map, &pair2);
+
+    pair pair3 = { .key = "xyz", .value = &(int){3} };
+    hashmap_set(map, &pair3);
+
+    // setting "abc" again replaces its value rather than adding a second entry
+    pair pair4 = { .key = "abc", .value = &(int){4} };
+    hashmap_set(map, &pair4);
+
+    // every key is visited exactly once, "abc" with its newer value
+    int seen[5] = { 0 };
+    hashmap_iter_init(map, &it);
+    for (pair *p = hashmap_iter_next(&it); p != NULL; p = hashmap_iter_next(&it)) {
+        seen[*(int *)p->value]++;
+    }
+    assert(seen[1] == 0);
+    assert(seen[2] == 1);
+    assert(seen[3] == 1);
+    assert(seen[4] == 1);
+
+    // deleting the current entry while iterating
+    int visited = 0;
+    hashmap_iter_init(map, &it);
+    for (pair *p = hashmap_iter_next(&it); p != NULL; p = hashmap_iter_next(&it)) {
+        visited++;
+        if (*(int *)p->value != 3) {
+            hashmap_delete(map, p);
+        }
+    }
+    assert(visited == 3);
+
+    hashmap_iter_init(map, &it);
+    pair *found_pair = hashmap_iter_next(&it);
+    assert(strcmp((char *)found_pair->key, "xyz") == 0);
+    assert(hashmap_iter_next(&it) == NULL);
+
+    hashmap_free(map);
+}
+
+void sum_values(pair *p, void *arg) {
+    atomic_fetch_add((atomic_long *)arg, *(int *)p->value);
+}
+
+void test_hashmap_foreach_parallel() {
+    // enough entries for several chunks of buckets
+    size_t n = 5000;
+    pair *pairs = test_pairs(n);
+    void *keys[n + 1];
+    void *values[n + 1];
+    long expected = 0;
+    for (size_t i = 0; i < n; i++) {
+        keys[i] = pairs[i].key;
+        values[i] = pairs[i].value;
+        expected += *(int *)pairs[i].value;
+    }
+    // repeat "key0" with a new value, which should be counted once
+    keys[n] = pairs[0].key;
+    values[n] = &(int){-1};
+    expected -= 1;
+    hashmap *map = hashmap_build(keys, values, n + 1, 4, hash_pair_key, hashmap_compare_pairs);
+
+    size_t thread_counts[] = { 0, 1, 3, 16 };
+    for (size_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); t++) {
+        atomic_long sum;
+        atomic_init(&sum, 0);
+        hashmap_foreach_parallel(map, thread_counts[t], sum_values, &sum);
+        assert(atomic_load(&sum) == expected);
+    }
+
+    // the same key set twice through hashmap_set is also counted once
+    pair pair1 = { .key = "abc", .value = &(int){100} };
+    hashmap_set(map, &pair1);
+    pair pair2 = { .key = "abc", .value = &(int){200} };
+    hashmap_set(map, &pair2);
+
+    atomic_long sum;
+    atomic_init(&sum, 0);
+    hashmap_foreach_parallel(map, 4, sum_values, &sum);
+    assert(atomic_load(&sum) == expected + 200);
+
+    hashmap_free(map);
+    free(pairs);
+}
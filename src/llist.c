@@ -50,10 +50,12 @@ llist_node *llist_find(llist_node *head, void *data, llist_compare_fn cmp) {
     return NULL; // Return NULL if no match is found
 }
 
-// Delete a node from the linked list, found matching data by the list_compare_function
-void llist_delete(llist_node **head, void *data, llist_compare_fn cmp) {
+// Unlink a node from the linked list, found matching data by the list_compare_function.
+// The node is returned to the caller, who becomes responsible for freeing it.
+// Returns NULL if no match is found.
+llist_node *llist_remove(llist_node **head, void *data, llist_compare_fn cmp) {
     if (head == NULL || *head == NULL) {
-        return; // Do nothing if the list or node is NULL
+        return NULL; // Do nothing if the list or node is NULL
     }
 
     llist_node *cur = *head;
@@ -62,19 +64,29 @@ void llist_delete(llist_node **head, void *data, llist_compare_fn cmp) {
     while (cur != NULL) {
         if (cmp(cur->data, data)) {
             if (prev == NULL) {
-                // Head node case: the node to delete is the head
+                // Head node case: the node to remove is the head
                 *head = cur->next;
             } else {
                 // Bypass the current node
                 prev->next = cur->next;
             }
-            free(cur->data); // free the current node
-            free(cur);
-            return;
+            cur->next = NULL;
+            return cur;
         }
         prev = cur;
         cur = cur->next;
     }
+    return NULL;
+}
+
+// Delete a node from the linked list, found matching data by the list_compare_function
+void llist_delete(llist_node **head, void *data, llist_compare_fn cmp) {
+    llist_node *node = llist_remove(head, data, cmp);
+    if (node == NULL) {
+        return;
+    }
+    free(node->data); // free the removed node
+    free(node);
 }
 
 // Tests
@@ -198,6 +210,43 @@ void test_llist_delete() {
     llist_free(head);
 }
 
+// Test llist remove
+void test_llist_remove() {
+    int data1 = 10;
+    int data2 = 20;
+    int data3 = 30;
+    int data4 = 40;
+
+    llist_node *head = llist_new(&data3, sizeof(data3));;
+    head = llist_prepend(head, &data1, sizeof(data1));
+    head = llist_prepend(head, &data2, sizeof(data2));
+
+    // data order: 2 1 3
+    assert(llist_remove(NULL, &data1, compare_ints) == NULL); // should work without any errors
+    assert(llist_remove(&head, &data4, compare_ints) == NULL);
+
+    // remove from the middle
+    llist_node *removed = llist_remove(&head, &data1, compare_ints);
+    assert(removed != NULL);
+    assert(*(int *)removed->data == 10);
+    assert(removed->next == NULL);
+    assert(llist_find(head, &data1, compare_ints) == NULL);
+    assert(*(int *)head->data == data2);
+    assert(*(int *)head->next->data == data3);
+    free(removed->data);
+    free(removed);
+
+    // remove the head
+    removed = llist_remove(&head, &data2, compare_ints);
+    assert(removed != NULL);
+    assert(*(int *)head->data == data3);
+    assert(head->next == NULL);
+    free(removed->data);
+    free(removed);
+
+    llist_free(head);
+}
+
 // A simple comparison function for pairs
 bool compare_pairs(const void *a, const void *b) {
     return strcmp(((pair *)a)->key, ((pair *)b)->key) == 0;